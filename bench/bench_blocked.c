@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * bench_blocked.c
+ *
+ * Measures how many blocked requests per second the proxy answers.
+ * Every worker thread opens a connection, sends a GET for a host that
+ * is in the proxy's filter file, reads the response to the end and
+ * counts its status code.
+ *
+ * Each connection comes from a different loopback address
+ * (127.<thread + 1>.x.y), so the per-client rate limiter does not
+ * turn the benchmark into a 429 benchmark.
+ */
+
+#define MAX_BENCH_THREADS 64
+#define RESPONSE_BUFFER_SIZE 4096
+#define READ_TIMEOUT_SEC 2
+
+struct BenchConfig {
+    in_port_t port;
+    char* blocked_host;
+    int threads;
+    int seconds;
+};
+
+struct BenchConfig bench_config;
+
+/**
+ * the counters of one worker thread
+ */
+typedef struct bench_result_st {
+    int id;
+    long forbidden;     //403 responses
+    long limited;       //429 responses
+    long other;         //any other response
+    long errors;        //connection or read errors
+} bench_result;
+
+// Current monotonic time in seconds
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Send one blocked request and return the response status code, or -1 on error
+int blocked_request(int id, unsigned int n, const char* request, size_t request_len) {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        return -1;
+    }
+
+    // Use a fresh source address for every connection
+    struct sockaddr_in source;
+    memset(&source, 0, sizeof(source));
+    source.sin_family = AF_INET;
+    source.sin_addr.s_addr = htonl((127u << 24) | ((unsigned int)(id + 1) << 16) | (n % 65534 + 1));
+    source.sin_port = 0;
+    if (bind(sock, (struct sockaddr*)&source, sizeof(source)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    // A connection the proxy never answers counts as an error instead of hanging the thread
+    struct timeval timeout = { .tv_sec = READ_TIMEOUT_SEC, .tv_usec = 0 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in proxy;
+    memset(&proxy, 0, sizeof(proxy));
+    proxy.sin_family = AF_INET;
+    proxy.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    proxy.sin_port = htons(bench_config.port);
+    if (connect(sock, (struct sockaddr*)&proxy, sizeof(proxy)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    if (write(sock, request, request_len) != (ssize_t)request_len) {
+        close(sock);
+        return -1;
+    }
+
+    // Keep the start of the response for the status code, discard the rest
+    char response[RESPONSE_BUFFER_SIZE];
+    char discard[RESPONSE_BUFFER_SIZE];
+    size_t total = 0;
+    ssize_t n_read;
+    while ((n_read = read(sock, response + total, sizeof(response) - 1 - total)) > 0) {
+        total += n_read;
+        if (total == sizeof(response) - 1) {
+            while ((n_read = read(sock, discard, sizeof(discard))) > 0) {
+            }
+            break;
+        }
+    }
+    close(sock);
+
+    int status;
+    response[total] = '\0';
+    if (n_read < 0 || sscanf(response, "HTTP/%*s %d", &status) != 1) {
+        return -1;
+    }
+    return status;
+}
+
+// Worker thread: send blocked requests until the time is up
+void* bench_worker(void* arg) {
+    bench_result* result = (bench_result*)arg;
+
+    char request[512];
+    int request_len = snprintf(request, sizeof(request),
+                               "GET http://%s/ HTTP/1.1\r\nHost: %s\r\n\r\n",
+                               bench_config.blocked_host, bench_config.blocked_host);
+
+    double deadline = now_sec() + bench_config.seconds;
+    for (unsigned int n = 0; now_sec() < deadline; n++) {
+        int status = blocked_request(result->id, n, request, request_len);
+        if (status == 403) {
+            result->forbidden++;
+        } else if (status == 429) {
+            result->limited++;
+        } else if (status < 0) {
+            result->errors++;
+        } else {
+            result->other++;
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    // Check command-line arguments
+    if (argc != 5) {
+        fprintf(stderr, "Usage: bench_blocked <proxy-port> <blocked-host> <threads> <seconds>\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bench_config.port = atoi(argv[1]);
+    bench_config.blocked_host = argv[2];
+    bench_config.threads = atoi(argv[3]);
+    bench_config.seconds = atoi(argv[4]);
+
+    if (bench_config.threads <= 0 || bench_config.threads > MAX_BENCH_THREADS || bench_config.seconds <= 0) {
+        fprintf(stderr, "Threads must be 1-%d and seconds must be positive\n", MAX_BENCH_THREADS);
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_t threads[MAX_BENCH_THREADS];
+    bench_result results[MAX_BENCH_THREADS];
+    memset(results, 0, sizeof(results));
+
+    double start = now_sec();
+    for (int i = 0; i < bench_config.threads; i++) {
+        results[i].id = i;
+        if (pthread_create(&threads[i], NULL, bench_worker, &results[i]) != 0) {
+            perror("Error creating bench thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    bench_result total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < bench_config.threads; i++) {
+        pthread_join(threads[i], NULL);
+        total.forbidden += results[i].forbidden;
+        total.limited += results[i].limited;
+        total.other += results[i].other;
+        total.errors += results[i].errors;
+    }
+    double elapsed = now_sec() - start;
+
+    printf("threads: %d, seconds: %.2f\n", bench_config.threads, elapsed);
+    printf("403: %ld, 429: %ld, other: %ld, errors: %ld\n",
+           total.forbidden, total.limited, total.other, total.errors);
+    printf("blocked requests/sec: %.0f\n", total.forbidden / elapsed);
+
+    return 0;
+}
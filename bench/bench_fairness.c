@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * bench_fairness.c
+ *
+ * Measures the latency a well-behaved client sees while another
+ * client floods the proxy.
+ *
+ * The flooder (127.0.0.2) keeps "flood-connections" connections open
+ * without sending anything, reconnecting whenever the proxy closes
+ * one, so every connection it gets through pins a worker.
+ * The well-behaved client (127.0.0.3) sends one blocked request every
+ * WELL_BEHAVED_INTERVAL_MS and records how long the response took.
+ * Run it with 0 flood connections for the baseline.
+ */
+
+#define MAX_FLOOD_THREADS 64
+#define MAX_SAMPLES 10000
+#define WELL_BEHAVED_INTERVAL_MS 200
+#define RESPONSE_TIMEOUT_SEC 10
+#define FLOOD_ADDRESS "127.0.0.2"
+#define WELL_BEHAVED_ADDRESS "127.0.0.3"
+#define RESPONSE_BUFFER_SIZE 4096
+
+struct BenchConfig {
+    in_port_t port;
+    char* blocked_host;
+    int flood_connections;
+    int seconds;
+};
+
+struct BenchConfig bench_config;
+
+double deadline;
+
+// Current monotonic time in seconds
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Connect to the proxy from the given loopback address, or return -1
+int connect_from(const char* source_ip, int timeout_sec) {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in source;
+    memset(&source, 0, sizeof(source));
+    source.sin_family = AF_INET;
+    inet_pton(AF_INET, source_ip, &source.sin_addr);
+    if (bind(sock, (struct sockaddr*)&source, sizeof(source)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    struct timeval timeout = { .tv_sec = timeout_sec, .tv_usec = 0 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in proxy;
+    memset(&proxy, 0, sizeof(proxy));
+    proxy.sin_family = AF_INET;
+    proxy.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    proxy.sin_port = htons(bench_config.port);
+    if (connect(sock, (struct sockaddr*)&proxy, sizeof(proxy)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+// Flood thread: hold an idle connection open, reconnect when the proxy closes it
+void* flood_worker(void* arg) {
+    (void)arg;
+
+    while (now_sec() < deadline) {
+        int sock = connect_from(FLOOD_ADDRESS, 1);
+        if (sock < 0) {
+            usleep(10000);
+            continue;
+        }
+
+        // Wait until the proxy closes the connection or the run is over
+        char buffer[RESPONSE_BUFFER_SIZE];
+        while (now_sec() < deadline) {
+            ssize_t n = read(sock, buffer, sizeof(buffer));
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                break;
+            }
+        }
+        close(sock);
+    }
+
+    return NULL;
+}
+
+// Send one blocked request and return its latency in milliseconds, or -1 on failure
+double timed_request(const char* request, size_t request_len) {
+    double start = now_sec();
+
+    int sock = connect_from(WELL_BEHAVED_ADDRESS, RESPONSE_TIMEOUT_SEC);
+    if (sock < 0) {
+        return -1;
+    }
+
+    if (write(sock, request, request_len) != (ssize_t)request_len) {
+        close(sock);
+        return -1;
+    }
+
+    // Read until the proxy closes the connection
+    char response[RESPONSE_BUFFER_SIZE];
+    size_t total = 0;
+    ssize_t n;
+    while ((n = read(sock, response, sizeof(response))) > 0) {
+        total += n;
+    }
+    close(sock);
+
+    if (n < 0 || total == 0) {
+        return -1;
+    }
+    return (now_sec() - start) * 1000;
+}
+
+int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+    // Check command-line arguments
+    if (argc != 5) {
+        fprintf(stderr, "Usage: bench_fairness <proxy-port> <blocked-host> <flood-connections> <seconds>\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bench_config.port = atoi(argv[1]);
+    bench_config.blocked_host = argv[2];
+    bench_config.flood_connections = atoi(argv[3]);
+    bench_config.seconds = atoi(argv[4]);
+
+    if (bench_config.flood_connections < 0 || bench_config.flood_connections > MAX_FLOOD_THREADS ||
+        bench_config.seconds <= 0) {
+        fprintf(stderr, "Flood connections must be 0-%d and seconds must be positive\n", MAX_FLOOD_THREADS);
+        exit(EXIT_FAILURE);
+    }
+
+    deadline = now_sec() + bench_config.seconds;
+
+    pthread_t threads[MAX_FLOOD_THREADS];
+    for (int i = 0; i < bench_config.flood_connections; i++) {
+        if (pthread_create(&threads[i], NULL, flood_worker, NULL) != 0) {
+            perror("Error creating flood thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Let the flood take hold before measuring
+    if (bench_config.flood_connections > 0) {
+        usleep(200000);
+    }
+
+    char request[512];
+    int request_len = snprintf(request, sizeof(request),
+                               "GET http://%s/ HTTP/1.1\r\nHost: %s\r\n\r\n",
+                               bench_config.blocked_host, bench_config.blocked_host);
+
+    static double samples[MAX_SAMPLES];
+    int count = 0;
+    int failures = 0;
+    while (now_sec() < deadline && count < MAX_SAMPLES) {
+        double latency = timed_request(request, request_len);
+        if (latency < 0) {
+            failures++;
+        } else {
+            samples[count++] = latency;
+        }
+        usleep(WELL_BEHAVED_INTERVAL_MS * 1000);
+    }
+
+    for (int i = 0; i < bench_config.flood_connections; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("flood connections: %d, requests: %d, failures: %d\n",
+           bench_config.flood_connections, count + failures, failures);
+    if (count > 0) {
+        qsort(samples, count, sizeof(double), compare_doubles);
+        printf("latency ms: p50 %.1f, p99 %.1f, max %.1f\n",
+               samples[count / 2], samples[(count * 99) / 100], samples[count - 1]);
+    }
+
+    return 0;
+}
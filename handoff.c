@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "handoff.h"
+
+// Fill a UNIX socket address for the given path
+static int make_address(const char* path, struct sockaddr_un* addr) {
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Handoff socket path is too long: %s\n", path);
+        return -1;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+// Create the control socket a future process connects to
+int handoff_listen(const char* path) {
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) < 0) {
+        return -1;
+    }
+
+    int control_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (control_socket < 0) {
+        perror("Error creating handoff socket");
+        return -1;
+    }
+
+    // The previous owner of the path has already handed off or exited
+    unlink(path);
+
+    if (bind(control_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Error binding handoff socket");
+        close(control_socket);
+        return -1;
+    }
+
+    if (listen(control_socket, 1) < 0) {
+        perror("Error listening on handoff socket");
+        close(control_socket);
+        return -1;
+    }
+
+    return control_socket;
+}
+
+// Take over the listening socket of the process running at path
+int handoff_receive(const char* path, ratelimiter* rl, int* ack_socket) {
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) < 0) {
+        return -1;
+    }
+
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conn < 0) {
+        perror("Error creating handoff socket");
+        return -1;
+    }
+
+    if (connect(conn, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        // Nobody to take over from: this is a cold start
+        if (errno != ENOENT && errno != ECONNREFUSED) {
+            perror("Error connecting to handoff socket");
+        }
+        close(conn);
+        return -1;
+    }
+
+    // Receive the message header with the listening socket attached
+    handoff_msg msg;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(conn, &hdr, MSG_WAITALL);
+
+    // Take every descriptor that arrived, so none is leaked if the message is rejected
+    int server_socket = -1;
+    int unexpected = 0;
+    if (received >= 0) {
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+                cmsg->cmsg_len >= CMSG_LEN(sizeof(int))) {
+                if (server_socket >= 0) {
+                    close(server_socket);
+                    unexpected = 1;
+                }
+                memcpy(&server_socket, CMSG_DATA(cmsg), sizeof(int));
+            } else {
+                unexpected = 1;
+            }
+        }
+    }
+
+    if (received != sizeof(msg) || (hdr.msg_flags & MSG_CTRUNC) || unexpected || server_socket < 0) {
+        fprintf(stderr, "Error receiving listening socket from running process\n");
+        if (server_socket >= 0) {
+            close(server_socket);
+        }
+        close(conn);
+        return -1;
+    }
+
+    if (msg.magic != HANDOFF_MAGIC || msg.version != HANDOFF_VERSION) {
+        fprintf(stderr, "Handoff message has an unknown format, keeping only the socket\n");
+    } else if (msg.state_size != ratelimit_state_size()) {
+        fprintf(stderr, "Rate limiter layout changed, starting with empty buckets\n");
+    } else {
+        ratelimit_load(rl, conn);
+    }
+
+    // Keep the connection open: the old process waits on it for the acknowledgement
+    *ack_socket = conn;
+    return server_socket;
+}
+
+// Tell the old process that the takeover is complete
+int handoff_confirm(int ack_socket) {
+    char ack = HANDOFF_ACK;
+    int result = 0;
+    if (send(ack_socket, &ack, 1, MSG_NOSIGNAL) != 1) {
+        perror("Error acknowledging handoff");
+        result = -1;
+    }
+    close(ack_socket);
+    return result;
+}
+
+// Send the listening socket and the buckets to the new process
+int handoff_send(int control_socket, int server_socket, ratelimiter* rl) {
+    int conn = accept(control_socket, NULL, NULL);
+    if (conn < 0) {
+        perror("Error accepting handoff connection");
+        return -1;
+    }
+
+    // Only a process of the same user may take the socket
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) < 0 || cred.uid != getuid()) {
+        fprintf(stderr, "Rejected handoff request from another user\n");
+        close(conn);
+        return -1;
+    }
+
+    handoff_msg msg;
+    msg.magic = HANDOFF_MAGIC;
+    msg.version = HANDOFF_VERSION;
+    msg.state_size = (uint32_t)ratelimit_state_size();
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    // Attach the listening socket
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &server_socket, sizeof(int));
+
+    if (sendmsg(conn, &hdr, MSG_NOSIGNAL) != sizeof(msg)) {
+        perror("Error sending listening socket");
+        close(conn);
+        return -1;
+    }
+
+    // A failure here only costs the warm buckets
+    ratelimit_save(rl, conn);
+
+    // Keep serving unless the new process confirms in time that it has taken over
+    struct timeval timeout = { .tv_sec = HANDOFF_ACK_TIMEOUT_SEC, .tv_usec = 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char ack;
+    ssize_t received = recv(conn, &ack, 1, 0);
+    close(conn);
+    if (received != 1 || ack != HANDOFF_ACK) {
+        fprintf(stderr, "New process did not confirm the handoff, still serving\n");
+        return -1;
+    }
+
+    return 0;
+}
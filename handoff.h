@@ -0,0 +1,84 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stdint.h>
+#include "ratelimit.h"
+
+/**
+ * handoff.h
+ *
+ * Passing the listening socket from a running proxy to the
+ * process that replaces it, over a UNIX domain socket.
+ *
+ * The running process listens on a control socket. A new process
+ * connects to it and receives the listening socket (SCM_RIGHTS) and
+ * a copy of the rate limiter buckets. Once it holds the socket and
+ * has its own control socket, it sends back an acknowledgement.
+ * Only then does the old process stop accepting and drain its queue,
+ * while the new process keeps accepting on the same socket, so no
+ * connection is refused. Without the acknowledgement the old process
+ * keeps serving.
+ */
+
+// identifies a handoff message ("PXHO")
+#define HANDOFF_MAGIC 0x5058484f
+
+// bumped whenever the message layout or the exchange changes
+#define HANDOFF_VERSION 2
+
+// the byte the new process sends once it has taken over
+#define HANDOFF_ACK 'A'
+
+// how long the old process waits for the acknowledgement
+#define HANDOFF_ACK_TIMEOUT_SEC 5
+
+
+/**
+ * the message sent along with the listening socket
+ */
+typedef struct handoff_msg_st {
+    uint32_t magic;         //HANDOFF_MAGIC
+    uint32_t version;       //HANDOFF_VERSION
+    uint32_t state_size;    //number of rate limiter bytes that follow
+} handoff_msg;
+
+
+/**
+ * handoff_listen creates the control socket at "path" that a
+ * future process connects to. Any stale socket file is replaced.
+ * Returns the control socket, or -1 on error.
+ */
+int handoff_listen(const char* path);
+
+
+/**
+ * handoff_receive connects to a running process at "path" and
+ * takes over its listening socket. The buckets it sends are loaded
+ * into "rl". Returns the listening socket, or -1 if no process
+ * is running there (the caller should create its own socket).
+ * On success "ack_socket" is set to the connection that
+ * handoff_confirm must be called with.
+ */
+int handoff_receive(const char* path, ratelimiter* rl, int* ack_socket);
+
+
+/**
+ * handoff_confirm tells the old process on "ack_socket" that the
+ * takeover is complete, and closes the connection.
+ * Call it only once the new process is ready to accept and to
+ * receive the next handoff. Returns 0 on success, -1 on error.
+ */
+int handoff_confirm(int ack_socket);
+
+
+/**
+ * handoff_send accepts the new process on "control_socket" and sends
+ * it "server_socket" and the buckets of "rl", then waits up to
+ * HANDOFF_ACK_TIMEOUT_SEC for its acknowledgement. Peers running as
+ * another user are rejected.
+ * Returns 0 once the new process has acknowledged, -1 if the transfer
+ * failed and the caller should keep serving.
+ */
+int handoff_send(int control_socket, int server_socket, ratelimiter* rl);
+
+#endif
@@ -3,22 +3,32 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 
 #include "threadpool.h"
+#include "ratelimit.h"
+#include "handoff.h"
+#include "responses.h"
 
 #define MAX_BUFFER_SIZE 15300
 #define MAX_HOSTNAME_SIZE 256
 #define FILTER_SIZE 200
+#define RATE_LIMIT_PER_SEC 10
+#define RATE_LIMIT_BURST 20
+#define DISCARD_BUFFER_SIZE 4096
+#define CLIENT_READ_TIMEOUT_SEC 2
 
 struct CommandLine {
     in_port_t port;
     int pool_size;
     int max_requests;
     char* filter_file;
+    char* handoff_path;  // NULL if graceful upgrade is disabled
 };
 
 struct CommandLine command_line;
@@ -26,6 +36,14 @@ struct CommandLine command_line;
 char filter[FILTER_SIZE][MAX_HOSTNAME_SIZE];
 int filter_count ;
 
+ratelimiter* client_limiter;
+
+// A client connection waiting for a worker
+struct ClientJob {
+    int socket;
+    uint32_t client_ip;
+};
+
 void read_filter_file() {
     filter_count = 0;
     FILE *fp = fopen(command_line.filter_file, "r");
@@ -109,88 +127,34 @@ int check_url_against_filter(const char *host) {
 }
 
 void send_not_supported_error(int *client_socket) {
-    char current_time[50];
-    time_t now = time(NULL);
-    strftime(current_time, sizeof(current_time), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&now));
-
-    char error_response[MAX_BUFFER_SIZE];
-    snprintf(error_response, sizeof(error_response),
-             "HTTP/1.1 501 Not Supported\r\n"
-             "Server: webserver/1.0\r\n"
-             "Date: %s\r\n"
-             "Content-Type: text/html\r\n"
-             "Content-Length: %lu\r\n"
-             "Connection: close\r\n"
-             "\r\n"
-             "<HTML><HEAD><TITLE>501 Not supported</TITLE></HEAD>\r\n"
-             "<BODY><H4>501 Not supported</H4>\r\n"
-             "Method is not supported.\r\n"
-             "</BODY></HTML>\r\n",
-             current_time, (unsigned long)strlen("Method is not supported.\r\n"));
-
-    write(*client_socket, error_response, strlen(error_response));
+    send_response(*client_socket, RESPONSE_501);
     close(*client_socket);
 }
 
 void send_404_error_response(int *client_socket) {
-    char error_response[] = "HTTP/1.1 404 Not Found\r\nServer: webserver/1.0\r\nDate: %s\r\nContent-Type: text/html\r\nContent-Length: %d\r\nConnection: close\r\n\r\n<HTML><HEAD><TITLE>404 Not Found</TITLE></HEAD><BODY><H4>404 Not Found</H4>File not found.</BODY></HTML>";
-    char date[100];
-    time_t now = time(NULL);
-    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&now));
-    int content_length = snprintf(NULL, 0, error_response, date, 112);
-    char response[content_length + 1];
-    sprintf(response, error_response, date, 112);
-    write(*client_socket, response, content_length);
+    send_response(*client_socket, RESPONSE_404);
+    close(*client_socket);
 }
 
 void send_403_error_response(int *client_socket) {
-    // Get the current time
-    time_t now = time(NULL);
-    char current_time[50];
-    strftime(current_time, sizeof(current_time), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&now));
-
-    // Define the error message
-    const char *error_message = "<HTML><HEAD><TITLE>403 Forbidden</TITLE></HEAD>\r\n"
-                                "<BODY><H4>403 Forbidden</H4>\r\n"
-                                "Access denied.\r\n"
-                                "</BODY></HTML>\r\n";
-    size_t content_length = strlen(error_message);
-
-    // Prepare the error response with dynamic values
-    char error_response[MAX_BUFFER_SIZE];
-    snprintf(error_response, sizeof(error_response),
-             "HTTP/1.1 403 Forbidden\r\n"
-             "Server: webserver/1.0\r\n"
-             "Date: %s\r\n"
-             "Content-Type: text/html\r\n"
-             "Content-Length: %zu\r\n"
-             "Connection: close\r\n"
-             "\r\n"
-             "%s",
-             current_time, content_length, error_message);
-
-    // Send the error response
-    write(*client_socket, error_response, strlen(error_response));
+    send_response(*client_socket, RESPONSE_403);
     close(*client_socket);
 }
 
-void send_400_error_response(int client_socket, const char* message) {
-    // Get the current time
-    time_t now = time(NULL);
-    char current_time[50];
-    strftime(current_time, sizeof(current_time), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&now));
-
-    // Calculate the length of the message
-    size_t message_length = strlen(message);
+void send_400_error_response(int client_socket) {
+    send_response(client_socket, RESPONSE_400);
+    close(client_socket);
+}
 
-    // Prepare the error response with dynamic values
-    char error_response[MAX_BUFFER_SIZE];
-    snprintf(error_response, sizeof(error_response),
-             "HTTP/1.1 400 Bad Request\r\nServer: webserver/1.0\r\nDate: %s\r\nContent-Type: text/html\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n<HTML><HEAD><TITLE>400 Bad Request</TITLE></HEAD>\r\n<BODY><H4>400 Bad Request</H4>\r\n%s\r\n</BODY></HTML>\r\n",
-             current_time, message_length, message);
+void send_429_error_response(int client_socket) {
+    send_response(client_socket, RESPONSE_429);
 
-    // Send the error response
-    write(client_socket, error_response, strlen(error_response));
+    // Best effort: discard the request bytes that already arrived so close() does not
+    // reset the connection. A request that arrives after close() still gets a reset.
+    // This runs on the accept thread, so read at most once and never wait.
+    char discard[DISCARD_BUFFER_SIZE];
+    shutdown(client_socket, SHUT_WR);
+    recv(client_socket, discard, sizeof(discard), MSG_DONTWAIT);
     close(client_socket);
 }
 
@@ -224,15 +188,14 @@ void handle_request(int *client_socket) {
     // Attempt to parse the request line
     if (sscanf(buffer, "%9s %s %s", method, url, protocol) != 3) {
         // Send a 400 Bad Request response if parsing fails
-        send_400_error_response(*client_socket, "Bad Request.");
-        close(*client_socket);
+        send_400_error_response(*client_socket);
         return;
     }
 
     // Check if the protocol is one of the HTTP versions
     if (strcasecmp(protocol, "HTTP/1.0") != 0 && strcasecmp(protocol, "HTTP/1.1") != 0) {
         // Send a 400 Bad Request response if the protocol is not supported
-        send_400_error_response(*client_socket,"Bad Request.");
+        send_400_error_response(*client_socket);
         return;
     }
 
@@ -282,9 +245,8 @@ void handle_request(int *client_socket) {
     if (check_url_against_filter(host)) {
         // Send a 403 Forbidden error response
         send_403_error_response(client_socket);
-            close(*client_socket);
-            return;
-        }
+        return;
+    }
 
     // Create a socket to connect to the destination server
     int dest_socket;
@@ -293,8 +255,7 @@ void handle_request(int *client_socket) {
     // Resolve the destination host
     struct hostent *host_info = gethostbyname(host);
     if (host_info == NULL) {
-        send_404_error_response( client_socket);
-        close(*client_socket);
+        send_404_error_response(client_socket);
         return;
     }
 
@@ -364,6 +325,23 @@ void handle_request(int *client_socket) {
     close(dest_socket);
 }
 
+// Thread pool entry point: takes ownership of the heap allocated client job
+int handle_client(void *arg) {
+    struct ClientJob *job = (struct ClientJob *)arg;
+    int client_socket = job->socket;
+    uint32_t client_ip = job->client_ip;
+    free(job);
+
+    // A client that connects and stays silent gives the worker back after the timeout
+    struct timeval timeout = { .tv_sec = CLIENT_READ_TIMEOUT_SEC, .tv_usec = 0 };
+    setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    handle_request(&client_socket);
+
+    ratelimit_release(client_limiter, client_ip);
+    return 0;
+}
+
 // Function to initialize the server socket
 int initialize_server(in_port_t port) {
     int server_socket;
@@ -397,10 +375,34 @@ int initialize_server(in_port_t port) {
 }
 
 // Function to listen for incoming client connections
-void listen_for_requests(int server_socket, threadpool* tp) {
+// Returns 1 if the listening socket was handed to a new process, 0 otherwise
+int listen_for_requests(int server_socket, int control_socket, threadpool* tp) {
+
+    struct pollfd fds[2];
+    fds[0].fd = server_socket;
+    fds[0].events = POLLIN;
+    fds[1].fd = control_socket;  // ignored by poll when -1
+    fds[1].events = POLLIN;
 
     while (command_line.max_requests > 0) {
 
+        if (poll(fds, 2, -1) < 0) {
+            perror("Error polling server sockets");
+            continue;
+        }
+
+        // A new process wants to take over: give it the socket and stop accepting
+        if (fds[1].revents & POLLIN) {
+            if (handoff_send(control_socket, server_socket, client_limiter) == 0) {
+                printf("Listening socket handed off, draining in-flight requests.\n");
+                return 1;
+            }
+        }
+
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
         int client_socket;
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(struct sockaddr_in);
@@ -411,20 +413,37 @@ void listen_for_requests(int server_socket, threadpool* tp) {
             continue;
         }
 
-        // Dispatch a task to the thread pool to handle the client connection
-        dispatch(tp, (dispatch_fn)handle_request, (void*)&client_socket);
+        command_line.max_requests--;
 
-        usleep(100000); // Sleep for 0.1 seconds
-        close (client_socket);
+        // Turn away clients that are over their rate limit, or that already hold
+        // their share of the workers, before they reach the queue
+        uint32_t client_ip = client_addr.sin_addr.s_addr;
+        if (!ratelimit_allow(client_limiter, client_ip) || !ratelimit_acquire(client_limiter, client_ip)) {
+            send_429_error_response(client_socket);
+            continue;
+        }
 
-        command_line.max_requests--;
+        struct ClientJob *job = (struct ClientJob *)malloc(sizeof(struct ClientJob));
+        if (job == NULL) {
+            perror("Error allocating memory for client job");
+            ratelimit_release(client_limiter, client_ip);
+            close(client_socket);
+            continue;
+        }
+        job->socket = client_socket;
+        job->client_ip = client_ip;
+
+        // Dispatch a task to the thread pool, queued fairly per client address
+        dispatch_keyed(tp, handle_client, (void*)job, ratelimit_hash(client_ip));
     }
+
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
     // Check command-line arguments
-    if (argc != 5) {
-        fprintf(stderr, "Usage: proxyServer <port> <pool-size> <max-number-of-request> <filter>\n");
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: proxyServer <port> <pool-size> <max-number-of-request> <filter> [handoff-socket]\n");
         exit(EXIT_FAILURE);
     }
 
@@ -433,21 +452,61 @@ int main(int argc, char* argv[]) {
     command_line.pool_size = atoi(argv[2]);
     command_line.max_requests = atoi(argv[3]);
     command_line.filter_file = argv[4];
+    command_line.handoff_path = argc == 6 ? argv[5] : NULL;
 
     // Initialize your thread pool
     threadpool* tp = create_threadpool(command_line.pool_size);
 
-    // Initialize your server socket
-    int server_socket = initialize_server(command_line.port);
+    // Initialize the per-client rate limiter; one client may hold at most half the workers
+    int max_in_flight = command_line.pool_size / 2 > 0 ? command_line.pool_size / 2 : 1;
+    client_limiter = create_ratelimiter(RATE_LIMIT_PER_SEC, RATE_LIMIT_BURST, max_in_flight);
+
+    // Render the error responses and start the Date header timer
+    responses_init();
+
+    // Take over the socket of a running instance, or create a new one
+    int server_socket = -1;
+    int control_socket = -1;
+    int ack_socket = -1;
+    if (command_line.handoff_path != NULL) {
+        server_socket = handoff_receive(command_line.handoff_path, client_limiter, &ack_socket);
+    }
+    if (server_socket < 0) {
+        server_socket = initialize_server(command_line.port);
+    }
+    if (command_line.handoff_path != NULL) {
+        control_socket = handoff_listen(command_line.handoff_path);
+    }
+
+    // Let the old process go only once this one can serve and take the next upgrade;
+    // on failure exit without confirming, and the old process keeps serving
+    if (ack_socket >= 0) {
+        if (control_socket < 0 || handoff_confirm(ack_socket) < 0) {
+            fprintf(stderr, "Could not complete the takeover, leaving the running process in charge\n");
+            exit(EXIT_FAILURE);
+        }
+        printf("Took over listening socket from running process.\n");
+    }
 
     // Listen for incoming client connections
-    listen_for_requests(server_socket, tp);
+    int handed_off = listen_for_requests(server_socket, control_socket, tp);
 
-    // Close the server socket
+    // Close the server socket; after a handoff the new process keeps it open
     close(server_socket);
+    if (control_socket >= 0) {
+        close(control_socket);
+        // After a handoff the path belongs to the new process
+        if (!handed_off) {
+            unlink(command_line.handoff_path);
+        }
+    }
 
-    // Destroy the thread pool after serving the requests
+    // Destroy the thread pool after serving the requests (drains the queue)
     destroy_threadpool(tp);
 
+    destroy_ratelimiter(client_limiter);
+
+    responses_destroy();
+
     return 0;
 }
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "ratelimit.h"
+
+// Current monotonic time in milliseconds
+static int64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Mix the address bits so neighbouring addresses land in different shards
+unsigned int ratelimit_hash(uint32_t client_ip) {
+    uint32_t h = client_ip;
+    h ^= h >> 16;
+    h *= 0x7feb352d;
+    h ^= h >> 15;
+    h *= 0x846ca68b;
+    h ^= h >> 16;
+    return h;
+}
+
+// Create a rate limiter with the given refill rate and bucket size
+ratelimiter* create_ratelimiter(int rate_per_sec, int burst, int max_in_flight) {
+    if (rate_per_sec <= 0 || burst <= 0 || max_in_flight <= 0) {
+        fprintf(stderr, "Error creating rate limiter: rate, burst and in-flight cap must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ratelimiter* rl = (ratelimiter*)malloc(sizeof(ratelimiter));
+    if (rl == NULL) {
+        perror("Error allocating memory for rate limiter");
+        exit(EXIT_FAILURE);
+    }
+
+    rl->rate_per_sec = rate_per_sec;
+    rl->burst = burst;
+    rl->max_in_flight = max_in_flight;
+
+    for (int i = 0; i < RL_SHARDS; i++) {
+        memset(rl->shards[i].sets, 0, sizeof(rl->shards[i].sets));
+        memset(rl->shards[i].in_flight, 0, sizeof(rl->shards[i].in_flight));
+        if (pthread_mutex_init(&(rl->shards[i].lock), NULL) != 0) {
+            perror("Error initializing rate limiter mutex");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return rl;
+}
+
+// Take one token from the client's bucket, refilling it first
+int ratelimit_allow(ratelimiter* rl, uint32_t client_ip) {
+    unsigned int h = ratelimit_hash(client_ip);
+    rl_shard* shard = &(rl->shards[h % RL_SHARDS]);
+    int64_t now = now_ms();
+    int64_t capacity = (int64_t)rl->burst * RL_TOKEN_SCALE;
+    int allowed;
+
+    pthread_mutex_lock(&(shard->lock));
+
+    bucket_t* set = shard->sets[(h / RL_SHARDS) % RL_SETS_PER_SHARD];
+    bucket_t* bucket = NULL;
+    bucket_t* victim = &set[0];
+
+    // Find the client's bucket, or the free / least recently used one
+    for (int i = 0; i < RL_WAYS; i++) {
+        if (set[i].client_ip == client_ip) {
+            bucket = &set[i];
+            break;
+        }
+        if (victim->client_ip != 0 &&
+            (set[i].client_ip == 0 || set[i].last_refill_ms < victim->last_refill_ms)) {
+            victim = &set[i];
+        }
+    }
+
+    if (bucket == NULL) {
+        // A new client starts with a full bucket
+        bucket = victim;
+        bucket->client_ip = client_ip;
+        bucket->tokens = capacity;
+    } else {
+        // Add the tokens earned since the last refill
+        bucket->tokens += (now - bucket->last_refill_ms) * rl->rate_per_sec;
+        if (bucket->tokens > capacity) {
+            bucket->tokens = capacity;
+        }
+    }
+    bucket->last_refill_ms = now;
+
+    if (bucket->tokens >= RL_TOKEN_SCALE) {
+        bucket->tokens -= RL_TOKEN_SCALE;
+        allowed = 1;
+    } else {
+        allowed = 0;
+    }
+
+    pthread_mutex_unlock(&(shard->lock));
+
+    return allowed;
+}
+
+// Count one more queued or running job for the client, unless it is at its cap
+int ratelimit_acquire(ratelimiter* rl, uint32_t client_ip) {
+    unsigned int h = ratelimit_hash(client_ip);
+    rl_shard* shard = &(rl->shards[h % RL_SHARDS]);
+    int* in_flight = &(shard->in_flight[(h / RL_SHARDS) % RL_IN_FLIGHT_SLOTS]);
+    int acquired = 0;
+
+    pthread_mutex_lock(&(shard->lock));
+    if (*in_flight < rl->max_in_flight) {
+        (*in_flight)++;
+        acquired = 1;
+    }
+    pthread_mutex_unlock(&(shard->lock));
+
+    return acquired;
+}
+
+// End one of the client's in-flight jobs
+void ratelimit_release(ratelimiter* rl, uint32_t client_ip) {
+    unsigned int h = ratelimit_hash(client_ip);
+    rl_shard* shard = &(rl->shards[h % RL_SHARDS]);
+
+    pthread_mutex_lock(&(shard->lock));
+    shard->in_flight[(h / RL_SHARDS) % RL_IN_FLIGHT_SLOTS]--;
+    pthread_mutex_unlock(&(shard->lock));
+}
+
+// Number of bytes in a saved table
+size_t ratelimit_state_size() {
+    return RL_SHARDS * sizeof(((rl_shard*)0)->sets);
+}
+
+// Write every shard's buckets to the given socket
+int ratelimit_save(ratelimiter* rl, int fd) {
+    for (int i = 0; i < RL_SHARDS; i++) {
+        pthread_mutex_lock(&(rl->shards[i].lock));
+
+        const char* data = (const char*)rl->shards[i].sets;
+        size_t left = sizeof(rl->shards[i].sets);
+        while (left > 0) {
+            ssize_t sent = send(fd, data, left, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                pthread_mutex_unlock(&(rl->shards[i].lock));
+                perror("Error sending rate limiter state");
+                return -1;
+            }
+            data += sent;
+            left -= sent;
+        }
+
+        pthread_mutex_unlock(&(rl->shards[i].lock));
+    }
+
+    return 0;
+}
+
+// Read every shard's buckets from the given socket
+int ratelimit_load(ratelimiter* rl, int fd) {
+    for (int i = 0; i < RL_SHARDS; i++) {
+        pthread_mutex_lock(&(rl->shards[i].lock));
+
+        char* data = (char*)rl->shards[i].sets;
+        size_t left = sizeof(rl->shards[i].sets);
+        while (left > 0) {
+            ssize_t received = read(fd, data, left);
+            if (received <= 0) {
+                pthread_mutex_unlock(&(rl->shards[i].lock));
+                perror("Error receiving rate limiter state");
+                for (int j = 0; j < RL_SHARDS; j++) {
+                    pthread_mutex_lock(&(rl->shards[j].lock));
+                    memset(rl->shards[j].sets, 0, sizeof(rl->shards[j].sets));
+                    pthread_mutex_unlock(&(rl->shards[j].lock));
+                }
+                return -1;
+            }
+            data += received;
+            left -= received;
+        }
+
+        pthread_mutex_unlock(&(rl->shards[i].lock));
+    }
+
+    return 0;
+}
+
+// Destroy the rate limiter and free associated resources
+void destroy_ratelimiter(ratelimiter* rl) {
+    if (rl == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < RL_SHARDS; i++) {
+        pthread_mutex_destroy(&(rl->shards[i].lock));
+    }
+    free(rl);
+}
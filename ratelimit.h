@@ -0,0 +1,128 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * ratelimit.h
+ *
+ * Per-client token buckets keyed by IPv4 address.
+ * The table has a fixed size: it is split into shards, each shard
+ * has its own lock and a small set-associative array of buckets.
+ * A lookup touches one shard and at most RL_WAYS buckets.
+ */
+
+// number of independently locked shards (power of two)
+#define RL_SHARDS 16
+
+// number of bucket sets in each shard (power of two)
+#define RL_SETS_PER_SHARD 64
+
+// number of buckets in each set
+#define RL_WAYS 4
+
+// tokens are stored in thousandths so refill does not lose fractions
+#define RL_TOKEN_SCALE 1000
+
+// number of in-flight counters in each shard (clients that share one share the cap)
+#define RL_IN_FLIGHT_SLOTS 256
+
+
+/**
+ * one client's token bucket
+ */
+typedef struct bucket_st {
+    uint32_t client_ip;     //client address in network byte order, 0 if free
+    int64_t tokens;         //available tokens * RL_TOKEN_SCALE
+    int64_t last_refill_ms; //monotonic time of the last refill
+} bucket_t;
+
+
+/**
+ * a group of buckets protected by one lock
+ */
+typedef struct _rl_shard_st {
+    pthread_mutex_t lock;
+    bucket_t sets[RL_SETS_PER_SHARD][RL_WAYS];
+    int in_flight[RL_IN_FLIGHT_SLOTS];  //jobs queued or running, not part of saved state
+} rl_shard;
+
+
+/**
+ * The rate limiter
+ */
+typedef struct _ratelimiter_st {
+    int rate_per_sec;   //tokens added to each bucket per second
+    int burst;          //maximum tokens a bucket can hold
+    int max_in_flight;  //maximum jobs one client may have queued or running
+    rl_shard shards[RL_SHARDS];
+} ratelimiter;
+
+
+/**
+ * create_ratelimiter allocates a limiter that lets every client make
+ * "burst" requests at once and "rate_per_sec" requests per second after that,
+ * with at most "max_in_flight" of them queued or running at the same time.
+ * If the function succeeds, it returns a (non-NULL) "ratelimiter".
+ */
+ratelimiter* create_ratelimiter(int rate_per_sec, int burst, int max_in_flight);
+
+
+/**
+ * ratelimit_allow takes one token from the bucket of "client_ip".
+ * The bucket is refilled lazily from the time passed since its last use.
+ * Returns 1 if the request may proceed, 0 if the client is over its limit.
+ */
+int ratelimit_allow(ratelimiter* rl, uint32_t client_ip);
+
+
+/**
+ * ratelimit_acquire counts one more job of "client_ip" as in flight.
+ * Returns 1 on success, 0 if the client already has max_in_flight jobs
+ * (nothing is counted then). Every success must be paired with
+ * ratelimit_release once the job is done.
+ */
+int ratelimit_acquire(ratelimiter* rl, uint32_t client_ip);
+
+
+/**
+ * ratelimit_release ends one in-flight job of "client_ip".
+ */
+void ratelimit_release(ratelimiter* rl, uint32_t client_ip);
+
+
+/**
+ * ratelimit_hash spreads a client address over the table.
+ * The thread pool uses the same value to pick the client's queue.
+ */
+unsigned int ratelimit_hash(uint32_t client_ip);
+
+
+/**
+ * ratelimit_state_size is the number of bytes ratelimit_save writes.
+ */
+size_t ratelimit_state_size();
+
+
+/**
+ * ratelimit_save writes every bucket to "fd", one shard at a time.
+ * Returns 0 on success, -1 on a write error.
+ */
+int ratelimit_save(ratelimiter* rl, int fd);
+
+
+/**
+ * ratelimit_load replaces every bucket with the ones read from "fd".
+ * Returns 0 on success, -1 on a read error (the table is then cleared).
+ */
+int ratelimit_load(ratelimiter* rl, int fd);
+
+
+/**
+ * destroy_ratelimiter frees the limiter and its locks.
+ */
+void destroy_ratelimiter(ratelimiter* rl);
+
+#endif
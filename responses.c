@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "responses.h"
+
+static response_template templates[NUM_RESPONSES];
+
+// The shared Date header and the timer that refreshes it
+static char date_line[DATE_LINE_SIZE + 1];
+static pthread_mutex_t date_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t date_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t date_thread;
+static int date_stop;
+
+// Render one template from its status line, extra headers and body
+static void render_template(response_id id, const char* status_line, const char* extra_headers, const char* body) {
+    response_template* t = &templates[id];
+
+    t->status_len = snprintf(t->status, sizeof(t->status),
+                             "%s\r\n"
+                             "Server: webserver/1.0\r\n",
+                             status_line);
+
+    t->body = body;
+    t->body_len = strlen(body);
+
+    t->fields_len = snprintf(t->fields, sizeof(t->fields),
+                             "Content-Type: text/html\r\n"
+                             "Content-Length: %zu\r\n"
+                             "%s"
+                             "Connection: close\r\n"
+                             "\r\n",
+                             t->body_len, extra_headers);
+}
+
+// Format the current time into the shared Date header
+static void refresh_date() {
+    char line[DATE_LINE_SIZE + 1];
+    time_t now = time(NULL);
+    struct tm tm_now;
+    gmtime_r(&now, &tm_now);
+    strftime(line, sizeof(line), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm_now);
+
+    pthread_mutex_lock(&date_lock);
+    memcpy(date_line, line, sizeof(date_line));
+    pthread_mutex_unlock(&date_lock);
+}
+
+// Timer thread: refresh the Date header at every second boundary
+static void* date_timer(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&date_lock);
+    while (!date_stop) {
+        struct timespec wake;
+        clock_gettime(CLOCK_REALTIME, &wake);
+        wake.tv_sec++;
+        wake.tv_nsec = 0;
+        pthread_cond_timedwait(&date_cond, &date_lock, &wake);
+
+        if (!date_stop) {
+            pthread_mutex_unlock(&date_lock);
+            refresh_date();
+            pthread_mutex_lock(&date_lock);
+        }
+    }
+    pthread_mutex_unlock(&date_lock);
+
+    return NULL;
+}
+
+// Render all templates and start the Date timer
+void responses_init() {
+    render_template(RESPONSE_400, "HTTP/1.1 400 Bad Request", "",
+                    "<HTML><HEAD><TITLE>400 Bad Request</TITLE></HEAD>\r\n"
+                    "<BODY><H4>400 Bad Request</H4>\r\n"
+                    "Bad Request.\r\n"
+                    "</BODY></HTML>\r\n");
+
+    render_template(RESPONSE_403, "HTTP/1.1 403 Forbidden", "",
+                    "<HTML><HEAD><TITLE>403 Forbidden</TITLE></HEAD>\r\n"
+                    "<BODY><H4>403 Forbidden</H4>\r\n"
+                    "Access denied.\r\n"
+                    "</BODY></HTML>\r\n");
+
+    render_template(RESPONSE_404, "HTTP/1.1 404 Not Found", "",
+                    "<HTML><HEAD><TITLE>404 Not Found</TITLE></HEAD>"
+                    "<BODY><H4>404 Not Found</H4>"
+                    "File not found."
+                    "</BODY></HTML>");
+
+    render_template(RESPONSE_429, "HTTP/1.1 429 Too Many Requests", "Retry-After: 1\r\n",
+                    "<HTML><HEAD><TITLE>429 Too Many Requests</TITLE></HEAD>\r\n"
+                    "<BODY><H4>429 Too Many Requests</H4>\r\n"
+                    "</BODY></HTML>\r\n");
+
+    render_template(RESPONSE_501, "HTTP/1.1 501 Not Supported", "",
+                    "<HTML><HEAD><TITLE>501 Not supported</TITLE></HEAD>\r\n"
+                    "<BODY><H4>501 Not supported</H4>\r\n"
+                    "Method is not supported.\r\n"
+                    "</BODY></HTML>\r\n");
+
+    refresh_date();
+
+    date_stop = 0;
+    if (pthread_create(&date_thread, NULL, date_timer, NULL) != 0) {
+        perror("Error creating date timer thread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Send a pre-rendered response with one gather call
+int send_response(int client_socket, response_id id) {
+    const response_template* t = &templates[id];
+
+    char date[DATE_LINE_SIZE];
+    pthread_mutex_lock(&date_lock);
+    memcpy(date, date_line, DATE_LINE_SIZE);
+    pthread_mutex_unlock(&date_lock);
+
+    struct iovec iov[4];
+    iov[0].iov_base = (void*)t->status;
+    iov[0].iov_len = t->status_len;
+    iov[1].iov_base = date;
+    iov[1].iov_len = DATE_LINE_SIZE;
+    iov[2].iov_base = (void*)t->fields;
+    iov[2].iov_len = t->fields_len;
+    iov[3].iov_base = (void*)t->body;
+    iov[3].iov_len = t->body_len;
+
+    // sendmsg instead of writev: same single gather call, but a reset client
+    // gives EPIPE instead of killing the process with SIGPIPE
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 4;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(client_socket, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            // A client that already went away is not worth a log line
+            if (errno != ECONNRESET && errno != EPIPE) {
+                perror("Error sending error response");
+            }
+            return -1;
+        }
+
+        // Skip what was written if the socket only took part of it
+        while (msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov->iov_len) {
+            sent -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + sent;
+            msg.msg_iov->iov_len -= sent;
+        }
+    }
+
+    return 0;
+}
+
+// Stop the Date timer
+void responses_destroy() {
+    pthread_mutex_lock(&date_lock);
+    date_stop = 1;
+    pthread_cond_signal(&date_cond);
+    pthread_mutex_unlock(&date_lock);
+
+    pthread_join(date_thread, NULL);
+}
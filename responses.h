@@ -0,0 +1,72 @@
+#ifndef RESPONSES_H
+#define RESPONSES_H
+
+#include <stddef.h>
+
+/**
+ * responses.h
+ *
+ * Pre-rendered HTTP error responses.
+ * Every response is split into segments that are rendered once:
+ * the status line, the headers after Date, and the body.
+ * The Date header is shared by all responses and refreshed once
+ * a second by a timer thread, so sending a response costs one
+ * gather sendmsg call and no formatting.
+ */
+
+// length of "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+#define DATE_LINE_SIZE 37
+
+// maximum length of a rendered header segment
+#define RESPONSE_HEADER_SIZE 256
+
+
+/**
+ * the responses that have a template
+ */
+typedef enum {
+    RESPONSE_400,
+    RESPONSE_403,
+    RESPONSE_404,
+    RESPONSE_429,
+    RESPONSE_501,
+    NUM_RESPONSES
+} response_id;
+
+
+/**
+ * the rendered segments of one response
+ */
+typedef struct response_template_st {
+    char status[RESPONSE_HEADER_SIZE];   //status line and Server header
+    size_t status_len;
+    char fields[RESPONSE_HEADER_SIZE];   //headers after Date and the blank line
+    size_t fields_len;
+    const char* body;
+    size_t body_len;
+} response_template;
+
+
+/**
+ * responses_init renders every template and starts the timer
+ * thread that refreshes the Date header.
+ * It must be called before any response is sent.
+ */
+void responses_init();
+
+
+/**
+ * send_response writes the response "id" to "client_socket"
+ * with a single gather sendmsg call (more only if the socket takes
+ * part of it). The socket is not closed.
+ * Returns 0 on success, -1 on a write error.
+ */
+int send_response(int client_socket, response_id id);
+
+
+/**
+ * responses_destroy stops the timer thread.
+ */
+void responses_destroy();
+
+#endif
@@ -29,6 +29,7 @@ threadpool* create_threadpool(int num_threads_in_pool) {
         exit(EXIT_FAILURE);
     }
 
+    memset(pool->flows, 0, sizeof(pool->flows));
     pool->qhead = pool->qtail = NULL;
     pool->shutdown = pool->dont_accept = 0;
 
@@ -77,10 +78,28 @@ void* do_work(void* p) {
         }
 
         if (pool->qhead != NULL) {
-            work_t* task = pool->qhead;
-            pool->qhead = task->next;
+            flow_t* flow = pool->qhead;
+
+            work_t* task = flow->head;
+            flow->head = task->next;
             pool->qsize--;
 
+            // Drop an empty flow from the list, or move it to the back for its next turn
+            if (flow->head == NULL) {
+                flow->tail = NULL;
+                flow->active = 0;
+                pool->qhead = flow->next_active;
+                if (pool->qhead == NULL) {
+                    pool->qtail = NULL;
+                }
+                flow->next_active = NULL;
+            } else if (flow->next_active != NULL) {
+                pool->qhead = flow->next_active;
+                pool->qtail->next_active = flow;
+                pool->qtail = flow;
+                flow->next_active = NULL;
+            }
+
             if (pool->qsize == 0 && pool->dont_accept) {
                 pthread_cond_signal(&(pool->q_empty));
             }
@@ -98,6 +117,11 @@ void* do_work(void* p) {
 
 // Add a task to the thread pool's queue
 void dispatch(threadpool* from_me, dispatch_fn dispatch_to_here, void *arg) {
+    dispatch_keyed(from_me, dispatch_to_here, arg, 0);
+}
+
+// Add a task to the queue of the flow selected by key
+void dispatch_keyed(threadpool* from_me, dispatch_fn dispatch_to_here, void *arg, unsigned int key) {
     pthread_mutex_lock(&(from_me->qlock));
 
     work_t* new_work = (work_t*)malloc(sizeof(work_t));
@@ -118,11 +142,24 @@ void dispatch(threadpool* from_me, dispatch_fn dispatch_to_here, void *arg) {
         return;
     }
 
-    if (from_me->qsize == 0) {
-        from_me->qhead = from_me->qtail = new_work;
+    flow_t* flow = &(from_me->flows[key % NUM_FLOWS]);
+    if (flow->head == NULL) {
+        flow->head = flow->tail = new_work;
     } else {
-        from_me->qtail->next = new_work;
-        from_me->qtail = new_work;
+        flow->tail->next = new_work;
+        flow->tail = new_work;
+    }
+
+    // A flow that just got its first job joins the back of the round-robin list
+    if (!flow->active) {
+        flow->active = 1;
+        flow->next_active = NULL;
+        if (from_me->qtail == NULL) {
+            from_me->qhead = from_me->qtail = flow;
+        } else {
+            from_me->qtail->next_active = flow;
+            from_me->qtail = flow;
+        }
     }
 
     from_me->qsize++;
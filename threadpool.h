@@ -10,6 +10,9 @@
 // maximum number of threads allowed in a pool
 #define MAXT_IN_POOL 200
 
+// number of per-client queues the pool schedules between
+#define NUM_FLOWS 256
+
 
 /**
  * the pool holds a queue of this structure
@@ -21,6 +24,18 @@ typedef struct work_st{
 } work_t;
 
 
+/**
+ * the jobs of the clients that hash to the same slot.
+ * flows that have jobs are linked in a round-robin list.
+ */
+typedef struct flow_st{
+    work_t* head;       //first job of this flow
+    work_t* tail;       //last job of this flow
+    int active;         //1 if the flow is in the round-robin list
+    struct flow_st* next_active;
+} flow_t;
+
+
 /**
  * The actual pool
  */
@@ -28,8 +43,9 @@ typedef struct _threadpool_st {
     int num_threads;	//number of active threads
     int qsize;	        //number in the queue
     pthread_t *threads;	//pointer to threads
-    work_t* qhead;		//queue head pointer
-    work_t* qtail;		//queue tail pointer
+    flow_t flows[NUM_FLOWS];	//per-client queues
+    flow_t* qhead;		//first flow in the round-robin list
+    flow_t* qtail;		//last flow in the round-robin list
     pthread_mutex_t qlock;		//lock on the queue list
     pthread_cond_t q_not_empty;	//non empty and empty condidtion vairiables
     pthread_cond_t q_empty;
@@ -72,12 +88,20 @@ threadpool* create_threadpool(int num_threads_in_pool);
  */
 void dispatch(threadpool* from_me, dispatch_fn dispatch_to_here, void *arg);
 
+/**
+ * dispatch_keyed is like dispatch, but queues the job on the flow
+ * chosen by "key" (for example a hash of the client address).
+ * Workers take one job from each flow in turn (round-robin),
+ * so a client that sends many requests cannot starve the others.
+ */
+void dispatch_keyed(threadpool* from_me, dispatch_fn dispatch_to_here, void *arg, unsigned int key);
+
 /**
  * The work function of the thread
  * this function should:
  * 1. lock mutex
  * 2. if the queue is empty, wait
- * 3. take the first element from the queue (work_t)
+ * 3. take the first element (work_t) of the flow whose turn it is
  * 4. unlock mutex
  * 5. call the thread routine
  *